@@ -0,0 +1,87 @@
+/* Comparaison de conteneurs STL utilisant std::allocator, mem_allocator
+ * et mem_memory_resource (pmr) sur des cycles d'insertions / suppressions
+ */
+#include "mem.h"
+#include "common.h"
+#include "mem_allocator.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+#define NB_TOURS 20
+#define NB_ELEMENTS 2000
+
+/* Clés pseudo-aléatoires reproductibles */
+static int cle(int i) {
+	return (i*7919) % 100003;
+}
+
+template <class Vector>
+static void churn_vector(Vector &v) {
+	for (int tour=0; tour<NB_TOURS; tour++) {
+		for (int i=0; i<NB_ELEMENTS*5; i++) {
+			v.push_back(i);
+		}
+		v.clear();
+		v.shrink_to_fit();
+	}
+}
+
+template <class Map>
+static void churn_map(Map &m) {
+	for (int tour=0; tour<NB_TOURS; tour++) {
+		for (int i=0; i<NB_ELEMENTS; i++) {
+			m[cle(i)] = i;
+		}
+		for (int i=0; i<NB_ELEMENTS; i+=2) {	// On libère dans le désordre
+			m.erase(cle(i));
+		}
+		m.clear();
+	}
+}
+
+/* Temps en millisecondes d'une exécution de f, le tas étant réinitialisé */
+static double mesure(const std::function<void()> &f) {
+	mem_init(get_memory_adr(), get_memory_size());
+	auto debut = std::chrono::steady_clock::now();
+	f();
+	auto fin = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(fin-debut).count();
+}
+
+static void affiche(const char *conteneur, double std_ms, double mem_ms, double pmr_ms) {
+	printf("%-15s %12.2f %15.2f %12.2f\n", conteneur, std_ms, mem_ms, pmr_ms);
+}
+
+int main() {
+	printf("%-15s %12s %15s %12s\n", "(ms)", "std::allocator", "mem_allocator", "pmr");
+
+	affiche("vector",
+		mesure([] { std::vector<int> v; churn_vector(v); }),
+		mesure([] { std::vector<int, mem_allocator<int>> v; churn_vector(v); }),
+		mesure([] { std::pmr::vector<int> v(mem_get_memory_resource()); churn_vector(v); }));
+
+	affiche("map",
+		mesure([] { std::map<int, int> m; churn_map(m); }),
+		mesure([] {
+			std::map<int, int, std::less<int>, mem_allocator<std::pair<const int, int>>> m;
+			churn_map(m);
+		}),
+		mesure([] { std::pmr::map<int, int> m(mem_get_memory_resource()); churn_map(m); }));
+
+	affiche("unordered_map",
+		mesure([] { std::unordered_map<int, int> m; churn_map(m); }),
+		mesure([] {
+			std::unordered_map<int, int, std::hash<int>, std::equal_to<int>,
+				mem_allocator<std::pair<const int, int>>> m;
+			churn_map(m);
+		}),
+		mesure([] { std::pmr::unordered_map<int, int> m(mem_get_memory_resource()); churn_map(m); }));
+
+	return 0;
+}
@@ -0,0 +1,94 @@
+/* Comparaison de mem_fit_first (parcours de la liste chaînée) et de
+ * mem_fit_first_index (index des ZL, pour chaque noyau de recherche)
+ * selon le nombre de zones libres
+ *
+ * Chaque mesure est une série d'allocations que seule la dernière zone libre
+ * peut accueillir : la recherche parcourt donc toute la liste (ou tout
+ * l'index). Seul mem_alloc est chronométré, la zone étant rendue par
+ * mem_free entre deux recherches.
+ */
+#include "mem.h"
+#include <stdio.h>
+#include <time.h>
+
+#define TAILLE_MEMOIRE (16*1024*1024)
+#define NB_RECHERCHES 20000
+#define RESERVE (512*1024)	// Place pour l'index, libérée avant les mesures
+#define TAILLE_BLOC 48
+#define TAILLE_DERNIERE 256	// Taille de la dernière zone libre, la seule assez grande
+#define NB_MAX_ZL 8000
+
+static char memoire[TAILLE_MEMOIRE];
+static void *blocs[2*NB_MAX_ZL];
+
+/* Mémoire entièrement occupée, puis nb_zl zones libres de TAILLE_BLOC
+ * suivies d'une zone libre de TAILLE_DERNIERE, dont l'adresse est renvoyée.
+ * Il n'y a plus de zone de queue.
+ */
+static void *fragmenter(int nb_zl) {
+	void *reserve = mem_alloc(RESERVE);
+	for (int i=0; i<2*nb_zl; i++) {
+		blocs[i] = mem_alloc(TAILLE_BLOC);
+	}
+	void *derniere = mem_alloc(TAILLE_DERNIERE);
+	for (size_t taille = TAILLE_MEMOIRE; taille > 0; taille /= 2) {	// On remplit le reste
+		while (mem_alloc(taille) != NULL);
+	}
+	mem_free(reserve);
+	for (int i=0; i<2*nb_zl; i+=2) {
+		mem_free(blocs[i]);
+	}
+	mem_free(mem_alloc(8));	// L'index éventuel est agrandi dans la réserve
+	void *p;
+	while ((p = mem_alloc(TAILLE_BLOC)) < blocs[0]);	// Puis on remplit ce qui reste de la réserve
+	mem_free(p);
+	mem_free(derniere);
+	return derniere;
+}
+
+/* Temps en millisecondes de NB_RECHERCHES recherches jusqu'à la dernière ZL */
+static double mesure(mem_fit_function_t *f, enum mem_index_kernel noyau, int nb_zl) {
+	struct timespec debut, fin;
+	double ms = 0;
+	mem_init(memoire, TAILLE_MEMOIRE);
+	mem_fit(f);
+	if (!mem_fit_index_kernel(noyau)) {
+		return -1;
+	}
+	void *derniere = fragmenter(nb_zl);
+
+	for (int i=0; i<NB_RECHERCHES; i++) {
+		clock_gettime(CLOCK_MONOTONIC, &debut);
+		void *p = mem_alloc(TAILLE_DERNIERE);
+		clock_gettime(CLOCK_MONOTONIC, &fin);
+		ms += (fin.tv_sec-debut.tv_sec)*1e3+(fin.tv_nsec-debut.tv_nsec)/1e6;
+		if (p != derniere) {
+			fprintf(stderr, "Allocation inattendue\n");
+		}
+		mem_free(p);
+	}
+	return ms;
+}
+
+static void affiche(double ms) {
+	if (ms < 0) {
+		printf(" %12s", "-");
+	} else {
+		printf(" %12.1f", ms);
+	}
+}
+
+int main() {
+	int nb_zl[] = {500, 1000, 2000, 4000, NB_MAX_ZL};
+
+	printf("%-8s %12s %12s %12s %12s\n", "ZL (ms)", "first", "index scal.", "index sse4.2", "index avx2");
+	for (int i=0; i<sizeof(nb_zl)/sizeof(nb_zl[0]); i++) {
+		printf("%-8d", nb_zl[i]);
+		affiche(mesure(&mem_fit_first, MEM_INDEX_AUTO, nb_zl[i]));
+		affiche(mesure(&mem_fit_first_index, MEM_INDEX_SCALAR, nb_zl[i]));
+		affiche(mesure(&mem_fit_first_index, MEM_INDEX_SSE42, nb_zl[i]));
+		affiche(mesure(&mem_fit_first_index, MEM_INDEX_AVX2, nb_zl[i]));
+		printf("\n");
+	}
+	return 0;
+}
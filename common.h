@@ -9,6 +9,10 @@
 #  define debug(...) ((void)0)
 #endif
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /* function to retrieve info about the globally allocated memory zone */
 void *get_memory_adr();
 size_t get_memory_size();
@@ -17,4 +21,8 @@ size_t mem_get_size(void *zone);
 /* function to try to allocate as much as memory as possible */
 void *alloc_max(size_t estimate);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,169 @@
+/* Macro-benchmark : exécute des programmes réels avec l'allocateur de la
+ * glibc puis avec libmalloc (LD_PRELOAD), et compare temps, RSS maximal et
+ * nombre d'appels à l'allocateur.
+ *
+ * Utilisation : ./macro_bench [bibliotheque.so]  (par défaut ./libmalloc_bench.so)
+ */
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define REPETITIONS 3	// On garde le meilleur temps
+#define NB_LIGNES_SORT 200000
+#define NB_ARGS 8
+
+struct programme {
+	const char *nom;
+	char *argv[NB_ARGS];
+};
+
+struct mesure {
+	double temps;	// Temps écoulé en secondes
+	long rss;	// RSS maximal en Ko (programme et ses fils)
+	int statut;	// Code de retour, -1 si tué par un signal
+	unsigned long appels[4];	// malloc, calloc, realloc, free (libmalloc uniquement)
+};
+
+/* Fichier d'entrée de sort : des lignes pseudo-aléatoires */
+static int creer_entree_sort(char *chemin) {
+	int fd = mkstemp(chemin);
+	if (fd < 0) {
+		return -1;
+	}
+	FILE *f = fdopen(fd, "w");
+	unsigned long x = 42;
+	for (int i=0; i<NB_LIGNES_SORT; i++) {
+		x = x*6364136223846793005UL+1442695040888963407UL;
+		fprintf(f, "%lx ligne %d\n", x, i);
+	}
+	fclose(f);
+	return 0;
+}
+
+/* Somme des lignes "malloc_stub: ..." écrites par chaque processus */
+static void lire_appels(FILE *err, struct mesure *m) {
+	char ligne[256];
+	unsigned long a[4];
+	memset(m->appels, 0, sizeof(m->appels));
+	rewind(err);
+	while (fgets(ligne, sizeof(ligne), err) != NULL) {
+		if (sscanf(ligne, "malloc_stub: %lu malloc %lu calloc %lu realloc %lu free",
+			   &a[0], &a[1], &a[2], &a[3]) == 4) {
+			for (int i=0; i<4; i++) {
+				m->appels[i] += a[i];
+			}
+		}
+	}
+}
+
+/* Une exécution de p, avec bib en LD_PRELOAD si elle n'est pas NULL */
+static void executer(struct programme *p, const char *bib, struct mesure *m) {
+	struct timespec debut, fin;
+	struct rusage usage;
+	int statut;
+	FILE *err = tmpfile();
+
+	clock_gettime(CLOCK_MONOTONIC, &debut);
+	pid_t pid = fork();
+	if (pid == 0) {
+		if (bib != NULL) {
+			setenv("LD_PRELOAD", bib, 1);
+			setenv("MALLOC_STUB_QUIET", "1", 1);
+			setenv("MALLOC_STUB_STATS", "1", 1);
+		} else {
+			unsetenv("LD_PRELOAD");
+		}
+		int null = open("/dev/null", O_WRONLY);
+		dup2(null, STDOUT_FILENO);
+		dup2(fileno(err), STDERR_FILENO);
+		execvp(p->argv[0], p->argv);
+		_exit(127);
+	}
+	wait4(pid, &statut, 0, &usage);	// rusage du fils et des descendants qu'il a attendus
+	clock_gettime(CLOCK_MONOTONIC, &fin);
+
+	m->temps = (fin.tv_sec-debut.tv_sec)+(fin.tv_nsec-debut.tv_nsec)/1e9;
+	m->rss = usage.ru_maxrss;
+	m->statut = WIFEXITED(statut) ? WEXITSTATUS(statut) : -1;
+	lire_appels(err, m);
+	fclose(err);
+}
+
+/* Meilleur temps sur REPETITIONS exécutions, arrêt au premier échec */
+static void mesurer(struct programme *p, const char *bib, struct mesure *m) {
+	struct mesure essai;
+	executer(p, bib, m);
+	for (int i=1; i<REPETITIONS && m->statut == 0; i++) {
+		executer(p, bib, &essai);
+		if (essai.statut != 0 || essai.temps < m->temps) {
+			*m = essai;
+		}
+	}
+}
+
+static void afficher_colonnes(struct mesure *m) {
+	if (m->statut == 0) {
+		printf(" %10.3f %10ld", m->temps, m->rss);
+	} else if (m->statut == 127) {
+		printf(" %21s", "absent");
+	} else {
+		printf(" %14s %6d", "ECHEC", m->statut);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	char bib[PATH_MAX];
+	char entree[] = "/tmp/macro_bench_XXXXXX";
+
+	if (realpath(argc > 1 ? argv[1] : "./libmalloc_bench.so", bib) == NULL) {	// LD_PRELOAD doit survivre aux chdir des programmes
+		perror("libmalloc");
+		return 1;
+	}
+	if (creer_entree_sort(entree) < 0) {
+		perror("mkstemp");
+		return 1;
+	}
+
+	struct programme programmes[] = {
+		{ "sort", { "sort", entree, NULL } },
+		{ "gcc", { "gcc", "-O2", "-c", "common.c", "-o", "/dev/null", NULL } },
+		{ "python3", { "python3", "-c",
+			"d = {i: str(i)*4 for i in range(200000)}\n"
+			"l = sorted(d.values(), key=len)\n"
+			"s = set(x[:3] for x in l)\n", NULL } },
+		{ "ls", { "ls", "-lR", "/usr/include", NULL } },
+	};
+	int nb_programmes = sizeof(programmes)/sizeof(programmes[0]);
+
+	printf("%-10s %10s %10s %10s %10s %8s   %s\n", "programme",
+	       "glibc (s)", "RSS (Ko)", "libmalloc", "RSS (Ko)", "rapport",
+	       "malloc/calloc/realloc/free");
+	for (int i=0; i<nb_programmes; i++) {
+		struct mesure glibc, libmalloc;
+		mesurer(&programmes[i], NULL, &glibc);
+		mesurer(&programmes[i], bib, &libmalloc);
+
+		printf("%-10s", programmes[i].nom);
+		afficher_colonnes(&glibc);
+		afficher_colonnes(&libmalloc);
+		if (glibc.statut == 0 && libmalloc.statut == 0) {
+			printf(" %7.2fx", libmalloc.temps/glibc.temps);
+		} else {
+			printf(" %8s", "-");
+		}
+		printf("   %lu/%lu/%lu/%lu\n", libmalloc.appels[0], libmalloc.appels[1],
+		       libmalloc.appels[2], libmalloc.appels[3]);
+		fflush(stdout);
+	}
+
+	unlink(entree);
+	return 0;
+}
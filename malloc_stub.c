@@ -2,12 +2,20 @@
 #include "common.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 static __thread int in_lib=0;
 
+/* MALLOC_STUB_QUIET : pas de trace à chaque appel
+ * MALLOC_STUB_STATS : nombre d'appels affiché à la fin du programme
+ */
+static int quiet=0;
+static int stats_fd=-1;	// Copie de stderr, que certains programmes ferment avant la fin
+static unsigned long nb_malloc=0, nb_calloc=0, nb_realloc=0, nb_free=0;
+
 #define dprintf(args...)			\
     do {					\
-	if (!in_lib) {				\
+	if (!in_lib && !quiet) {		\
 	    in_lib=1;				\
 	    fprintf(stderr, args);		\
 	    in_lib=0;				\
@@ -20,14 +28,32 @@ void init() {
 
     if (first) {
         mem_init(get_memory_adr(), get_memory_size());
+        quiet = getenv("MALLOC_STUB_QUIET") != NULL;
+        if (getenv("MALLOC_STUB_STATS"))
+            stats_fd = dup(STDERR_FILENO);
         first = 0;
     }
 }
 
+__attribute__((destructor))
+static
+void stats() {
+    char buffer[128];
+    int n;
+
+    if (stats_fd >= 0) {
+        n = snprintf(buffer, sizeof(buffer), "malloc_stub: %lu malloc %lu calloc %lu realloc %lu free\n",
+                     nb_malloc, nb_calloc, nb_realloc, nb_free);
+        if (write(stats_fd, buffer, n) < 0)
+            return;
+    }
+}
+
 void *malloc(size_t s) {
     void *result;
 
     init();
+    nb_malloc++;
     dprintf("Allocation de %lu octets...", (unsigned long) s);
     result = mem_alloc(s);
     if (!result)
@@ -43,6 +69,7 @@ void *calloc(size_t count, size_t size) {
     size_t s = count*size;
 
     init();
+    nb_calloc++;
     dprintf("Allocation de %zu octets\n", s);
     p = mem_alloc(s);
     if (!p)
@@ -54,33 +81,22 @@ void *calloc(size_t count, size_t size) {
 }
 
 void *realloc(void *ptr, size_t size) {
-    size_t s;
     char *result;
 
     init();
+    nb_realloc++;
     dprintf("Reallocation de la zone en %lx\n", (unsigned long) ptr);
-    if (!ptr) {
-        dprintf(" Realloc of NULL pointer\n");
-        return mem_alloc(size);
-    }
-    if (mem_get_size(ptr) >= size) {
-        dprintf(" Useless realloc\n");
-        return ptr;
-    }
-    result = mem_alloc(size);
-    if (!result) {
+    result = mem_realloc(ptr, size);
+    if (!result)
         dprintf(" Realloc FAILED\n");
-        return NULL;
-    }
-    for (s = 0; s<mem_get_size(ptr); s++)
-        result[s] = ((char *) ptr)[s];
-    mem_free(ptr);
-    dprintf(" Realloc ok\n");
+    else
+        dprintf(" Realloc ok\n");
     return result;
 }
 
 void free(void *ptr) {
     init();
+    nb_free++;
     if (ptr) {
         dprintf("Liberation de la zone en %lx\n", (unsigned long) ptr);
         mem_free(ptr);
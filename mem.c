@@ -3,7 +3,13 @@
 
 #include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 #include <valgrind/valgrind.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define FB_INDEX_SIMD
+#endif
 
 /* Définition de l'alignement recherché
  * Avec gcc, on peut utiliser __BIGGEST_ALIGNMENT__
@@ -15,6 +21,69 @@
 #define ALIGNMENT 16
 #endif
 
+/* Capacité de la première table de poignées (mem_halloc)
+ * Les tables sont allouées par mem_alloc au premier besoin, chacune deux
+ * fois plus grande que la précédente
+ */
+#define HANDLE_CHUNK_MIN 64
+
+/* Poignée vers un bloc relogeable
+ * ptr doit rester le premier champ : la poignée rendue à l'utilisateur
+ * est l'adresse de ce champ (void **)
+ * Le bloc alloué commence par l'adresse de sa poignée, ce qui permet à
+ * mem_compact de la retrouver sans parcourir les tables
+ */
+struct handle {
+	void *ptr;	// NULL si la poignée est inutilisée
+	struct handle *next_free;	// Poignée libre suivante (si ptr == NULL)
+	unsigned int locks;	// Bloc épinglé tant que locks > 0
+};
+
+/* Table de poignées, bloc fixe alloué par mem_alloc */
+struct handle_chunk {
+	struct handle_chunk *next;	// Table allouée précédemment
+	size_t nb_handles;
+	struct handle handles[];
+};
+
+/* Capacité minimale de l'index utilisé par mem_fit_first_index
+ * L'index est un bloc alloué dans la mémoire gérée, agrandi avec la liste des ZL
+ */
+#define FB_INDEX_MIN 64
+
+/* Recherche dans l'index de la première taille >= size
+ * Renvoie n si aucune taille ne convient
+ */
+typedef size_t (fb_index_search_t)(const size_t *sizes, size_t n, size_t size);
+
+/* Mode adaptatif (mem_fit_adaptive)
+ * Toutes les ADAPT_PERIOD allocations, les compteurs sont examinés et la
+ * stratégie éventuellement changée. Chaque changement est consigné dans un
+ * journal circulaire de ADAPT_LOG entrées (voir mem_fit_log).
+ */
+#ifndef ADAPT_PERIOD
+#define ADAPT_PERIOD 256
+#endif
+#ifndef ADAPT_LOG
+#define ADAPT_LOG 16
+#endif
+#define ADAPT_LONG_SEARCH 32	// Nombre moyen de ZL parcourues par recherche jugé excessif
+#define ADAPT_LONG_LIST 64	// En dessous de ce nombre de ZL, l'index n'est plus utile
+#define ADAPT_FRAGMENTATION 50	// Pourcentage de fragmentation jugé excessif
+
+struct adapt_stats {
+	size_t allocs;	// Allocations demandées
+	size_t failures;	// Allocations échouées
+	size_t search;	// Nombre de ZL parcourues (pointeur next suivi) par les fonctions de fit
+	size_t splits;	// Allocations ayant découpé une ZL (cas 1 de mem_alloc)
+};
+
+struct adapt_decision {
+	size_t alloc;	// Numéro de l'allocation ayant déclenché le changement
+	mem_fit_function_t *from;
+	mem_fit_function_t *to;
+	const char *reason;
+};
 
 /* structure placée au début de la zone de l'allocateur
 
@@ -27,6 +96,37 @@ struct allocator_header {
         size_t memory_size;
         struct fb* first;
 	mem_fit_function_t *fit;
+	/* Zone libre de queue (wilderness) : dernière ZL, qui s'étend jusqu'à la
+	 * fin de la mémoire, NULL si la dernière zone est occupée.
+	 * top_prec est la ZL qui la précède dans la liste (NULL si top est en tête)
+	 */
+	struct fb *top;
+	struct fb *top_prec;
+	/* Majorant de la taille des autres ZL (les trous) : une demande plus
+	 * grande ne peut être servie que par la zone de queue, sans recherche
+	 */
+	size_t holes_max;
+	struct handle_chunk *handle_chunks;	// Dernière table de poignées, NULL avant le premier mem_halloc
+	struct handle *free_handle;	// Première poignée libre, NULL si aucune
+	/* Index des ZL triées par adresse (structure de tableaux)
+	 * Tenu à jour uniquement lorsque fb_index_valid est vrai
+	 * Les deux tableaux sont dans fb_index_block, alloué par mem_alloc
+	 */
+	int fb_index_valid;
+	int fb_index_growing;	// Agrandissement en cours : mem_alloc ne doit pas utiliser l'index
+	size_t fb_index_count;
+	size_t fb_index_capacity;
+	fb_index_search_t *fb_index_search;
+	size_t fb_index_hit;	// Position de la dernière ZL trouvée par mem_fit_first_index
+	void *fb_index_block;
+	size_t *fb_index_size;
+	struct fb **fb_index_addr;
+	/* Compteurs et état du mode adaptatif */
+	struct adapt_stats stats;
+	size_t total_allocs;
+	mem_fit_function_t *adapt_fit;	// Stratégie courante du mode adaptatif
+	size_t adapt_log_count;
+	struct adapt_decision adapt_log[ADAPT_LOG];
 };
 
 /* La seule variable globale autorisée
@@ -49,13 +149,248 @@ static inline size_t get_system_memory_size() {
 	return get_header()->memory_size;
 }
 
+static inline void *get_first_zone() {
+	return get_system_memory_addr()+sizeof(struct allocator_header);
+}
+
 
 struct fb {
 	size_t size;
 	struct fb* next;
 };
 
+/* Suivi de la zone de queue, appelé après modification de la liste */
+
+/* La ZL fb est (de nouveau) chaînée juste après prev (NULL si en tête) */
+static void top_insert(struct fb *prev, struct fb *fb) {
+	struct allocator_header *h = get_header();
+	if ((void*)fb+fb->size == get_system_memory_addr()+get_system_memory_size()) {
+		h->top = fb;
+		h->top_prec = prev;
+		return;
+	}
+	if (fb->size > h->holes_max) {
+		h->holes_max = fb->size;
+	}
+	if (h->top != NULL && fb->next == h->top) {
+		h->top_prec = fb;
+	}
+}
+
+/* La ZL fb, qui suivait prev dans la liste, n'existe plus */
+static void top_remove(struct fb *prev, struct fb *fb) {
+	struct allocator_header *h = get_header();
+	if (fb == h->top) {
+		h->top = NULL;
+		h->top_prec = NULL;
+	} else if (fb == h->top_prec) {
+		h->top_prec = prev;
+	}
+}
+
+/* Recherches dans l'index des ZL
+ * Version scalaire, puis versions SSE4.2 / AVX2 choisies à l'exécution
+ * dans mem_init. Les tailles sont comparées en signé, ce qui est sans
+ * conséquence tant qu'elles restent inférieures à 2^63.
+ */
+static size_t fb_index_search_scalar(const size_t *sizes, size_t n, size_t size) {
+	size_t i;
+	for (i=0; i<n; i++) {
+		if (sizes[i] >= size) {
+			break;
+		}
+	}
+	return i;
+}
+
+#ifdef FB_INDEX_SIMD
+__attribute__((target("sse4.2")))
+static size_t fb_index_search_sse42(const size_t *sizes, size_t n, size_t size) {
+	__m128i seuil = _mm_set1_epi64x((long long)size-1);	// sizes[i] > size-1  <=>  sizes[i] >= size
+	size_t i = 0;
+	for (; i+4 <= n; i+=4) {	// 4 candidats par itération
+		__m128i a = _mm_loadu_si128((const __m128i*)(sizes+i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(sizes+i+2));
+		int masque = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(a, seuil)))
+			| _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(b, seuil))) << 2;
+		if (masque) {
+			return i+__builtin_ctz(masque);
+		}
+	}
+	return i+fb_index_search_scalar(sizes+i, n-i, size);
+}
+
+__attribute__((target("avx2")))
+static size_t fb_index_search_avx2(const size_t *sizes, size_t n, size_t size) {
+	__m256i seuil = _mm256_set1_epi64x((long long)size-1);
+	size_t i = 0;
+	for (; i+8 <= n; i+=8) {	// 8 candidats par itération
+		__m256i a = _mm256_loadu_si256((const __m256i*)(sizes+i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(sizes+i+4));
+		int masque = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(a, seuil)))
+			| _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(b, seuil))) << 4;
+		if (masque) {
+			return i+__builtin_ctz(masque);
+		}
+	}
+	return i+fb_index_search_scalar(sizes+i, n-i, size);
+}
+#endif
+
+/* Noyau de recherche demandé, NULL s'il n'est pas disponible sur ce processeur */
+static fb_index_search_t *fb_index_choose_search(enum mem_index_kernel k) {
+#ifdef FB_INDEX_SIMD
+	__builtin_cpu_init();	// Peut être appelé avant les constructeurs (libmalloc.so)
+	if ((k == MEM_INDEX_AUTO || k == MEM_INDEX_AVX2) && __builtin_cpu_supports("avx2")) {
+		return &fb_index_search_avx2;
+	}
+	if ((k == MEM_INDEX_AUTO || k == MEM_INDEX_SSE42) && __builtin_cpu_supports("sse4.2")) {
+		return &fb_index_search_sse42;
+	}
+#endif
+	if (k == MEM_INDEX_AUTO || k == MEM_INDEX_SCALAR) {
+		return &fb_index_search_scalar;
+	}
+	return NULL;
+}
+
+int mem_fit_index_kernel(enum mem_index_kernel k) {
+	fb_index_search_t *search = fb_index_choose_search(k);
+	if (search == NULL) {
+		return 0;
+	}
+	get_header()->fb_index_search = search;
+	return 1;
+}
+
+/* Position de la ZL fb dans l'index (ou position où l'insérer) */
+static size_t fb_index_find(struct fb *fb) {
+	size_t debut = 0, fin = get_header()->fb_index_count;
+	while (debut < fin) {	// Recherche dichotomique sur les adresses
+		size_t milieu = (debut+fin)/2;
+		if (get_header()->fb_index_addr[milieu] < fb) {
+			debut = milieu+1;
+		} else {
+			fin = milieu;
+		}
+	}
+	return debut;
+}
+
+/* Reconstruction complète de l'index à partir de la liste des ZL
+ * Renvoie 0 si l'index est trop petit (il reste alors invalide)
+ */
+static int fb_index_rebuild() {
+	struct allocator_header *h = get_header();
+	void *ptr_end_of_memory = get_system_memory_addr()+get_system_memory_size();
+	struct fb *current = h->first;
+	h->fb_index_count = 0;
+	h->fb_index_valid = 1;
+	while ((void*)current != ptr_end_of_memory) {
+		if (h->fb_index_count == h->fb_index_capacity) {	// Trop de ZL : index à agrandir
+			h->fb_index_valid = 0;
+			return 0;
+		}
+		h->fb_index_addr[h->fb_index_count] = current;
+		h->fb_index_size[h->fb_index_count] = current->size;
+		h->fb_index_count++;
+		current = current->next;
+	}
+	return 1;
+}
+
+/* Agrandissement de l'index : un nouveau bloc de deux fois le nombre de ZL
+ * est alloué (par first fit, l'index étant invalide pendant l'opération),
+ * puis l'ancien est libéré. En cas d'échec, l'index reste invalide et
+ * mem_fit_first_index revient au parcours de la liste.
+ * A n'appeler que lorsque la liste des ZL est cohérente (hors mem_alloc/mem_free)
+ */
+static void fb_index_grow() {
+	struct allocator_header *h = get_header();
+	void *ptr_end_of_memory = get_system_memory_addr()+get_system_memory_size();
+	if (h->fb_index_growing) {
+		return;
+	}
+	size_t nb_fb = 0;
+	for (struct fb *current = h->first; (void*)current != ptr_end_of_memory; current = current->next) {
+		nb_fb++;
+	}
+	size_t capacity = 2*(nb_fb+1) > FB_INDEX_MIN ? 2*(nb_fb+1) : FB_INDEX_MIN;
+
+	h->fb_index_growing = 1;
+	h->fb_index_valid = 0;	// Les mises à jour sont suspendues pendant l'agrandissement
+	void *block = mem_alloc(capacity*(sizeof(size_t)+sizeof(struct fb *)));
+	if (block != NULL) {
+		if (h->fb_index_block != NULL) {
+			mem_free(h->fb_index_block);
+		}
+		h->fb_index_block = block;
+		h->fb_index_capacity = capacity;
+		h->fb_index_size = block;
+		h->fb_index_addr = block+capacity*sizeof(size_t);
+	}
+	h->fb_index_growing = 0;
+	fb_index_rebuild();
+}
+
+/* Libération de l'index lorsqu'on change de stratégie */
+static void fb_index_release() {
+	struct allocator_header *h = get_header();
+	void *block = h->fb_index_block;
+	h->fb_index_valid = 0;
+	if (block != NULL && !h->fb_index_growing) {
+		h->fb_index_block = NULL;
+		h->fb_index_capacity = 0;
+		mem_free(block);
+	}
+}
+
+/* Mises à jour de l'index, appelées après modification de la liste */
+static void fb_index_insert(struct fb *fb) {
+	struct allocator_header *h = get_header();
+	if (!h->fb_index_valid) {
+		return;
+	}
+	if (h->fb_index_count == h->fb_index_capacity) {	// Agrandi au prochain appel de mem_fit_first_index
+		h->fb_index_valid = 0;
+		return;
+	}
+	size_t pos = fb_index_find(fb);
+	size_t n = h->fb_index_count-pos;
+	memmove(&h->fb_index_addr[pos+1], &h->fb_index_addr[pos], n*sizeof(struct fb *));
+	memmove(&h->fb_index_size[pos+1], &h->fb_index_size[pos], n*sizeof(size_t));
+	h->fb_index_addr[pos] = fb;
+	h->fb_index_size[pos] = fb->size;
+	h->fb_index_count++;
+}
+
+static void fb_index_remove(struct fb *fb) {
+	struct allocator_header *h = get_header();
+	if (!h->fb_index_valid) {
+		return;
+	}
+	size_t pos = fb_index_find(fb);
+	size_t n = h->fb_index_count-pos-1;
+	memmove(&h->fb_index_addr[pos], &h->fb_index_addr[pos+1], n*sizeof(struct fb *));
+	memmove(&h->fb_index_size[pos], &h->fb_index_size[pos+1], n*sizeof(size_t));
+	h->fb_index_count--;
+}
+
+/* La ZL old est remplacée par new (déplacement et/ou changement de taille)
+ * sans changer d'ordre par rapport aux autres ZL
+ */
+static void fb_index_replace(struct fb *old, struct fb *new) {
+	struct allocator_header *h = get_header();
+	if (!h->fb_index_valid) {
+		return;
+	}
+	size_t pos = fb_index_find(old);
+	h->fb_index_addr[pos] = new;
+	h->fb_index_size[pos] = new->size;
+}
+
 void mem_init(void* mem, size_t taille) {
+    assert(taille > sizeof(struct allocator_header)+sizeof(struct fb));	// Place pour l'en-tête et une ZL
     memory_addr = mem;
     *(size_t*)memory_addr = taille;
 	/* On vérifie qu'on a bien enregistré les infos et qu'on
@@ -64,21 +399,36 @@ void mem_init(void* mem, size_t taille) {
 	assert(mem == get_system_memory_addr());
 	assert(taille == get_system_memory_size());
 	
-	struct fb* fb = (struct fb*)(get_system_memory_addr()+sizeof(struct allocator_header));	// La première zone libre se situe après l'allocateur
+	struct fb* fb = (struct fb*)get_first_zone();	// La première zone libre se situe après l'allocateur
 	fb->size = taille-sizeof(struct allocator_header);	// On enlève donc la taille d'un allocateur à la taille de la mémoire
 	fb->next = get_system_memory_addr()+get_system_memory_size();
 
 	VALGRIND_CREATE_MEMPOOL(get_header(), 0, 0); // On ne gère pas les débordements mémoires, uniquement le nombre d'allocs/frees
 	get_header()->first = fb;
+	get_header()->top = fb;	// Au départ, toute la mémoire est la zone de queue
+	get_header()->top_prec = NULL;
+	get_header()->holes_max = 0;
+	get_header()->handle_chunks = NULL;	// Les poignées ne coûtent rien tant que mem_halloc n'est pas utilisée
+	get_header()->free_handle = NULL;
+	get_header()->fb_index_search = fb_index_choose_search(MEM_INDEX_AUTO);
+	get_header()->fb_index_valid = 0;
+	get_header()->fb_index_growing = 0;
+	get_header()->fb_index_count = 0;
+	get_header()->fb_index_hit = 0;
+	get_header()->fb_index_capacity = 0;
+	get_header()->fb_index_block = NULL;
+	memset(&get_header()->stats, 0, sizeof(struct adapt_stats));
+	get_header()->total_allocs = 0;
+	get_header()->adapt_fit = &mem_fit_first;
+	get_header()->adapt_log_count = 0;
 	
 	mem_fit(&mem_fit_first);
 }
 /*while < SIZE*/
 void mem_show(void (*print)(void *, size_t, int)) {
 	struct fb* ptr_current_fb = get_header()->first;
-	void* ptr_current_zone = get_system_memory_addr()+sizeof(struct allocator_header);
-	void *ptr_end_of_memory = get_system_memory_addr();
-	ptr_end_of_memory = ptr_end_of_memory+(get_system_memory_size()-sizeof(struct allocator_header));
+	void* ptr_current_zone = get_first_zone();
+	void *ptr_end_of_memory = get_system_memory_addr()+get_system_memory_size();
 
 	size_t block_size;
 	while (ptr_current_zone < ptr_end_of_memory) {
@@ -95,8 +445,32 @@ void mem_show(void (*print)(void *, size_t, int)) {
 	}
 }
 
+/* Stratégie réellement utilisée (celle choisie par le mode adaptatif le cas échéant) */
+static mem_fit_function_t *get_current_fit() {
+	if (get_header()->fit == &mem_fit_adaptive) {
+		return get_header()->adapt_fit;
+	}
+	return get_header()->fit;
+}
+
+/* L'index n'est tenu à jour que lorsque mem_fit_first_index est utilisée */
+static void fb_index_sync() {
+	if (get_current_fit() == &mem_fit_first_index) {
+		if (!fb_index_rebuild()) {
+			fb_index_grow();
+		}
+	} else {
+		fb_index_release();
+	}
+}
+
 void mem_fit(mem_fit_function_t *f) {
 	get_header()->fit = f;
+	if (f == &mem_fit_adaptive) {	// On repart de la stratégie par défaut
+		memset(&get_header()->stats, 0, sizeof(struct adapt_stats));
+		get_header()->adapt_fit = &mem_fit_first;
+	}
+	fb_index_sync();
 }
 
 
@@ -104,12 +478,33 @@ void *mem_alloc(size_t taille) {
 	if (taille <= 0){	// On évite des allocations inutiles ou illogiques
 		return NULL;
 	}
+	if (taille > SIZE_MAX-2*sizeof(size_t)-7) {	// La taille réelle, padding compris, déborderait
+		return NULL;
+	}
 	size_t taille_reelle = taille+2*sizeof(size_t);	// On rajoute la taille du bloc ainsi que la garde
 	if (taille_reelle % 8 != 0){
 		taille_reelle += (8 - taille_reelle % 8);	// Padding pour obtenir un multiple de 8
 	}
-	struct fb *fb=get_header()->fit(get_header()->first, taille_reelle);
+	struct fb *fb;
+	if (get_header()->first == get_header()->top) {	// Aucun trou
+		get_header()->holes_max = 0;
+	}
+	if (taille_reelle > get_header()->holes_max) {	// Aucun trou ne convient : on prend sur la zone de queue
+		fb = get_header()->top;
+		if (fb != NULL && fb->size < taille_reelle) {
+			fb = NULL;
+		}
+	} else {
+		fb = get_header()->fit(get_header()->first, taille_reelle);
+		mem_fit_function_t *f = get_current_fit();
+		if (fb == NULL || (fb == get_header()->top && (f == &mem_fit_first || f == &mem_fit_first_index))) {
+			get_header()->holes_max = taille_reelle-8;	// Tous les trous ont été écartés
+		}
+	}
+	get_header()->stats.allocs++;
+	get_header()->total_allocs++;
 	if (fb == NULL) {	// La mémoire n'a plus assez de place
+		get_header()->stats.failures++;
 		return NULL;
 	}
 
@@ -121,8 +516,15 @@ void *mem_alloc(size_t taille) {
 	
 	// On trouve la zone libre précédant la zone libre que l'on va modifier
 	struct fb *fb_prec = get_header()->first;
-
-	if (fb_prec != fb) {	// Pas besoin de parcours si la mémoire n'est qu'une seule zone libre
+	size_t pos = get_header()->fb_index_hit;
+	if (fb == get_header()->top && get_header()->top_prec != NULL) {	// Déjà connue pour la zone de queue
+		fb_prec = get_header()->top_prec;
+	} else if (get_header()->fb_index_valid && pos < get_header()->fb_index_count
+		   && get_header()->fb_index_addr[pos] == fb) {	// Trouvée par l'index : la précédente y est juste avant
+		if (pos > 0) {
+			fb_prec = get_header()->fb_index_addr[pos-1];
+		}
+	} else if (fb_prec != fb) {	// Pas besoin de parcours si la mémoire n'est qu'une seule zone libre
 		while (fb_prec->next != fb) {
 			fb_prec = fb_prec->next;
 		}
@@ -144,12 +546,18 @@ void *mem_alloc(size_t taille) {
 		fb->next = next_prec;
 		fb->size = taille_prec-taille_reelle;
 		fb_prec->next = fb;
+		fb_index_replace(fb_alias, fb);
+		top_remove(fb_alias == get_header()->first ? NULL : fb_prec, fb_alias);
+		top_insert(fb_alias == get_header()->first ? NULL : fb_prec, fb);
+		get_header()->stats.splits++;
 	} else {												// Cas 2
 		taille_reelle = taille_prec;	// On met la taille de l'allocation à la taille de la zone libre
 		pos_garde = zone_allouee_alias+taille_reelle-sizeof(size_t);
 		*(size_t*)pos_garde = garde;	
 		*zone_allouee = taille_reelle;
 		fb_prec->next = next_prec;
+		fb_index_remove(fb_alias);
+		top_remove(fb_alias == get_header()->first ? NULL : fb_prec, fb_alias);
 	}
 	if (fb_alias == get_header()->first) {
 		get_header()->first = fb_prec->next;
@@ -162,17 +570,71 @@ void *mem_alloc(size_t taille) {
 }
 
 
+/* Libération d'une zone collée à la zone de queue : on l'y fusionne sans
+ * parcourir la mémoire. Renvoie 0 si le chemin général est nécessaire
+ * (zone précédente libre, garde effacée...)
+ */
+static int mem_free_top(void *mem) {
+	struct allocator_header *h = get_header();
+	size_t *addr_to_free = mem-sizeof(size_t);
+	void *fin_zone = (void*)addr_to_free+*addr_to_free;
+	if (h->top == NULL || fin_zone != (void*)h->top || *(size_t*)(fin_zone-sizeof(size_t)) != -1) {
+		return 0;
+	}
+	if (h->top_prec != NULL && (void*)h->top_prec+h->top_prec->size >= (void*)addr_to_free) {	// Fusion à trois : chemin général
+		return 0;
+	}
+	struct fb *new_fb = (struct fb *)addr_to_free;
+	new_fb->size = *addr_to_free+h->top->size;
+	new_fb->next = h->top->next;
+	if (h->top_prec == NULL) {
+		h->first = new_fb;
+	} else {
+		h->top_prec->next = new_fb;
+	}
+	fb_index_replace(h->top, new_fb);
+	h->top = new_fb;
+	VALGRIND_MEMPOOL_FREE(get_header(), mem);
+	return 1;
+}
+
 void mem_free(void* mem) {
+    if (mem <= get_first_zone()
+        || mem >= get_system_memory_addr()+get_system_memory_size()) { //Erreur, mem n'est pas dans la zone geree
+        return;
+    }
+    if (mem_free_top(mem)) {
+        return;
+    }
     struct fb* ptr_current_fb = get_header()->first;
     struct fb* previous_fb=get_header()->first; //init pr eviter seg fault si liberation 1ere ZL
+    struct fb* before_previous_fb=NULL; //ZL precedant previous_fb (pour la zone de queue)
     int is_allocated_before=0; 
-    void* ptr_current_zone = get_system_memory_addr()+sizeof(struct allocator_header); //ptr vers debut allocateur
+    void* ptr_current_zone = get_first_zone(); //ptr vers debut allocateur
     size_t* addr_to_free = mem-sizeof(size_t); //ptr vers zone a liberer
     size_t block_size;
+	//Les ZL qui precedent la derniere ZL avant la zone a liberer sont sautees par la liste : le parcours des zones repart de cette ZL
+    if (get_header()->fb_index_valid) { //Avec l'index, ces ZL sont trouvees par dichotomie
+        size_t nb = fb_index_find((struct fb *)addr_to_free); //Nombre de ZL avant la zone a liberer
+        if (nb > 0) {
+            ptr_current_fb = get_header()->fb_index_addr[nb-1];
+            previous_fb = get_header()->fb_index_addr[nb > 1 ? nb-2 : 0];
+            before_previous_fb = nb > 2 ? get_header()->fb_index_addr[nb-3] : NULL;
+            ptr_current_zone = ptr_current_fb;
+        }
+    } else if ((void*)ptr_current_fb < (void*)addr_to_free) {
+        while ((void*)ptr_current_fb->next < (void*)addr_to_free) {
+            before_previous_fb = (previous_fb == ptr_current_fb) ? NULL : previous_fb;
+            previous_fb = ptr_current_fb;
+            ptr_current_fb = ptr_current_fb->next;
+        }
+        ptr_current_zone = ptr_current_fb;
+    }
 	//Parcours des ZL et ZA pour arriver a zone a liberer et savoir dans quelle configuration on est
     while (ptr_current_zone <(void*) addr_to_free ) {
         block_size = *(size_t*)ptr_current_zone;
         if (ptr_current_zone == (void*)ptr_current_fb) { //si on est sur ZL, on va chercher la prochaine ZL
+            before_previous_fb = (previous_fb == ptr_current_fb) ? NULL : previous_fb;
             previous_fb = ptr_current_fb;
             ptr_current_fb = ptr_current_fb->next;
             is_allocated_before=0;
@@ -190,7 +652,9 @@ void mem_free(void* mem) {
 		return;                                                                    
     }
     block_size = *(size_t*)ptr_current_zone;
-    int is_allocated_after=(ptr_current_zone+block_size != (size_t*)ptr_current_fb);
+    void *ptr_end_of_memory = get_system_memory_addr()+get_system_memory_size();
+    int is_allocated_after=(ptr_current_zone+block_size != (size_t*)ptr_current_fb
+                            || (void*)ptr_current_fb == ptr_end_of_memory); //la fin de liste n'est pas une ZL
 
     struct fb* new_fb;
     new_fb = (struct fb *)ptr_current_zone; //adresse de nouvelle ZL
@@ -202,9 +666,13 @@ void mem_free(void* mem) {
         if (!is_allocated_after) { //Cas 1 : soit la tete est le prochain bloc
             new_fb->size+=ptr_current_fb->size;
             new_fb->next=ptr_current_fb->next;
+            fb_index_replace(ptr_current_fb, new_fb);
+            top_remove(NULL, ptr_current_fb);
         } else { //Cas 2 : soit il y a un bloc entre le bloc a liberer et la 1ere ZL
             new_fb->next=ptr_current_fb;
+            fb_index_insert(new_fb);
         }
+        top_insert(NULL, new_fb);
 
 		//On fait comprendre à valgrind qu'on vient de free la zone pointée par mem
 		VALGRIND_MEMPOOL_FREE(get_header(), mem);
@@ -216,19 +684,30 @@ void mem_free(void* mem) {
         } if (!is_allocated_before && !is_allocated_after) {	//Cas 3 : On peut lier avant et apres
             previous_fb->size += block_size+ptr_current_fb->size;
             previous_fb->next=ptr_current_fb->next;
+            fb_index_remove(ptr_current_fb);
+            fb_index_replace(previous_fb, previous_fb);
+            top_remove(previous_fb, ptr_current_fb);
+            top_insert(before_previous_fb, previous_fb);
 
          } else if (!is_allocated_before) { //Cas 4 : On peut lier avant
             previous_fb->size += block_size;
             previous_fb->next=ptr_current_fb;
+            fb_index_replace(previous_fb, previous_fb);
+            top_insert(before_previous_fb, previous_fb);
 
          } else if (!is_allocated_after) { //Cas 5 : On peut lier apres
              previous_fb->next=new_fb;
              new_fb->size+=ptr_current_fb->size;
              new_fb->next=ptr_current_fb->next;
+             fb_index_replace(ptr_current_fb, new_fb);
+             top_remove(previous_fb, ptr_current_fb);
+             top_insert(previous_fb, new_fb);
 
          } else { //Cas 6 : On peut pas lier :(
              previous_fb->next=new_fb;
              new_fb->next=ptr_current_fb;
+             fb_index_insert(new_fb);
+             top_insert(previous_fb, new_fb);
          }
 		//On fait comprendre à valgrind qu'on vient de free la zone pointée par mem
 		VALGRIND_MEMPOOL_FREE(get_header(), mem);
@@ -236,6 +715,28 @@ void mem_free(void* mem) {
 }
 
 
+/* Première zone libre, recherchée dans l'index des ZL plutôt qu'en
+ * suivant les pointeurs next (parcours séquentiel, vectorisé si possible)
+ */
+struct fb* mem_fit_first_index(struct fb *list, size_t size) {
+	struct allocator_header *h = get_header();
+	if (h->fb_index_growing) {	// Allocation du nouvel index : parcours classique
+		return mem_fit_first(h->first, size);
+	}
+	if (!h->fb_index_valid) {	// Index trop petit : on l'agrandit
+		fb_index_grow();
+		if (!h->fb_index_valid) {	// Plus de place pour l'index : parcours classique
+			return mem_fit_first(h->first, size);
+		}
+	}
+	size_t i = h->fb_index_search(h->fb_index_size, h->fb_index_count, size);
+	if (i == h->fb_index_count) {
+		return NULL;
+	}
+	h->fb_index_hit = i;	// mem_alloc y retrouve la ZL précédente
+	return h->fb_index_addr[i];
+}
+
 struct fb* mem_fit_first(struct fb *list, size_t size) {
     struct fb* current = list;
     while((void*)current != get_system_memory_addr()+get_system_memory_size()) {
@@ -243,6 +744,7 @@ struct fb* mem_fit_first(struct fb *list, size_t size) {
             return current;
 		}
         current = current->next;
+        get_header()->stats.search++;
     }
     return NULL;
 }
@@ -255,27 +757,45 @@ struct fb* mem_fit_first(struct fb *list, size_t size) {
  * (ou en discuter avec l'enseignant)
  */
 size_t mem_get_size(void *zone) {
-	size_t taille_reelle = *(size_t*)zone;
+	size_t taille_reelle = *(size_t*)(zone-sizeof(size_t));	// zone est l'adresse rendue par mem_alloc
 	return taille_reelle-2*sizeof(size_t);
 }
 
+/* Réallocation : la zone est conservée si elle est déjà assez grande,
+ * sinon on alloue une nouvelle zone, on y recopie l'ancienne et on la libère
+ */
+void* mem_realloc(void *old, size_t new_size) {
+	if (old == NULL) {
+		return mem_alloc(new_size);
+	}
+	size_t old_size = mem_get_size(old);
+	if (old_size >= new_size) {
+		return old;
+	}
+	void *new = mem_alloc(new_size);
+	if (new == NULL) {
+		return NULL;
+	}
+	memcpy(new, old, old_size);
+	mem_free(old);
+	return new;
+}
+
 /* Fonctions facultatives
  * autres stratégies d'allocation
  */
 struct fb* mem_fit_best(struct fb *list, size_t size) {
-	struct fb* current = list;
-	while (current->size < size){	// On trouve la première zone libre capable d'accueillir size, si elle existe
-		current = current->next;
-		if (current == NULL){
-			return NULL;
-		}
+	struct fb* current = mem_fit_first(list, size);	// On trouve la première zone libre capable d'accueillir size, si elle existe
+	if (current == NULL){
+		return NULL;
 	}
 	struct fb* tmp = current;
-	while (current != NULL) {	// On cherche la taille la plus proche
+	while ((void*)current != get_system_memory_addr()+get_system_memory_size()) {	// On cherche la taille la plus proche
 		if (current->size >= size && current->size < tmp->size) {
 			tmp = current;
 		}
 		current = current->next;
+		get_header()->stats.search++;
 	}
 	return tmp;
 }
@@ -283,11 +803,15 @@ struct fb* mem_fit_best(struct fb *list, size_t size) {
 struct fb* mem_fit_worst(struct fb *list, size_t size) {
     struct fb* current = list;
     struct fb* tmp = current;
-    while(current != NULL) {	// On trouve la zone libre la plus grande
+    if ((void*)current == get_system_memory_addr()+get_system_memory_size()) {	// Aucune zone libre
+        return NULL;
+    }
+    while((void*)current != get_system_memory_addr()+get_system_memory_size()) {	// On trouve la zone libre la plus grande
         if(current->size >= tmp->size) {
             tmp = current;
 		}
         current = current->next;
+        get_header()->stats.search++;
     }
     if (tmp->size < size) {	// Puis on vérifie qu'elle est bien assez grande pour accueillir size
 		return NULL;
@@ -295,3 +819,249 @@ struct fb* mem_fit_worst(struct fb *list, size_t size) {
         return tmp;
 	}
 }
+
+
+/* Mode adaptatif
+ * Choix de la stratégie à partir des compteurs de la dernière période :
+ * - des échecs avec une mémoire fragmentée : best fit, qui découpe moins
+ *   les grandes zones libres
+ * - des recherches longues dans la liste chaînée : first fit par l'index,
+ *   qui ne suit plus les pointeurs next (son compteur reste donc faible :
+ *   on le conserve tant que la liste des ZL reste longue)
+ * - sinon first fit, la moins coûteuse sur une liste courte
+ */
+static const char *adapt_choose(mem_fit_function_t **choix) {
+	struct adapt_stats *stats = &get_header()->stats;
+	void *ptr_end_of_memory = get_system_memory_addr()+get_system_memory_size();
+	size_t nb_fb = 0, total = 0, largest = 0;
+	for (struct fb *current = get_header()->first; (void*)current != ptr_end_of_memory; current = current->next) {
+		nb_fb++;
+		total += current->size;
+		if (current->size > largest) {
+			largest = current->size;
+		}
+	}
+	// Fragmentation : part de l'espace libre hors de la plus grande ZL
+	size_t fragmentation = total ? 100-largest*100/total : 0;
+
+	if (stats->failures > 0 && fragmentation > ADAPT_FRAGMENTATION) {
+		*choix = &mem_fit_best;
+		return "echecs d'allocation avec memoire fragmentee";
+	}
+	if (stats->search > ADAPT_LONG_SEARCH*stats->allocs) {
+		*choix = &mem_fit_first_index;
+		return "recherches longues dans la liste des zones libres";
+	}
+	if (get_header()->adapt_fit == &mem_fit_first_index && nb_fb > ADAPT_LONG_LIST) {
+		*choix = &mem_fit_first_index;
+		return "liste de zones libres longue, index conserve";
+	}
+	*choix = &mem_fit_first;
+	if (stats->splits*2 > stats->allocs) {
+		return "peu de zones libres, decoupes frequentes";
+	}
+	return "peu de zones libres";
+}
+
+static void adapt_update() {
+	struct allocator_header *h = get_header();
+	mem_fit_function_t *choix;
+	const char *raison = adapt_choose(&choix);
+	memset(&h->stats, 0, sizeof(struct adapt_stats));	// Avant fb_index_sync, qui peut allouer
+	if (choix != h->adapt_fit) {	// On consigne le changement dans le journal
+		struct adapt_decision *d = &h->adapt_log[h->adapt_log_count % ADAPT_LOG];
+		d->alloc = h->total_allocs;
+		d->from = h->adapt_fit;
+		d->to = choix;
+		d->reason = raison;
+		h->adapt_log_count++;
+		h->adapt_fit = choix;
+		fb_index_sync();
+	}
+}
+
+struct fb* mem_fit_adaptive(struct fb *list, size_t size) {
+	if (get_header()->stats.allocs >= ADAPT_PERIOD) {
+		adapt_update();
+		list = get_header()->first;	// fb_index_sync a pu allouer ou libérer l'index : la liste a changé
+	}
+	return get_header()->adapt_fit(list, size);
+}
+
+static const char *fit_name(mem_fit_function_t *f) {
+	if (f == &mem_fit_first) return "first";
+	if (f == &mem_fit_first_index) return "first_index";
+	if (f == &mem_fit_best) return "best";
+	if (f == &mem_fit_worst) return "worst";
+	return "?";
+}
+
+void mem_fit_log(void (*print)(size_t alloc, const char *from, const char *to, const char *reason)) {
+	struct allocator_header *h = get_header();
+	size_t debut = h->adapt_log_count > ADAPT_LOG ? h->adapt_log_count-ADAPT_LOG : 0;
+	for (size_t i=debut; i<h->adapt_log_count; i++) {	// Du plus ancien au plus récent
+		struct adapt_decision *d = &h->adapt_log[i % ADAPT_LOG];
+		print(d->alloc, fit_name(d->from), fit_name(d->to), d->reason);
+	}
+}
+
+/* Ajout d'une table de poignées, toutes libres
+ * Renvoie 0 si la mémoire ne permet pas de l'allouer
+ */
+static int handle_grow() {
+	struct allocator_header *h = get_header();
+	size_t nb = h->handle_chunks == NULL ? HANDLE_CHUNK_MIN : 2*h->handle_chunks->nb_handles;
+	struct handle_chunk *chunk = mem_alloc(sizeof(struct handle_chunk)+nb*sizeof(struct handle));
+	if (chunk == NULL) {
+		return 0;
+	}
+	chunk->next = h->handle_chunks;
+	chunk->nb_handles = nb;
+	for (size_t i=0; i<nb; i++) {
+		chunk->handles[i].ptr = NULL;
+		chunk->handles[i].locks = 0;
+		chunk->handles[i].next_free = i+1 < nb ? &chunk->handles[i+1] : h->free_handle;
+	}
+	h->handle_chunks = chunk;
+	h->free_handle = chunk->handles;
+	return 1;
+}
+
+/* Allocation relogeable
+ * Le bloc est alloué normalement, précédé de l'adresse de sa poignée.
+ * Son adresse est stockée dans la poignée : seule mem_compact() peut la modifier
+ */
+void** mem_halloc(size_t size) {
+	struct allocator_header *h = get_header();
+	if (size > SIZE_MAX-sizeof(struct handle *)) {	// Place pour l'adresse de la poignée
+		return NULL;
+	}
+	if (h->free_handle == NULL && !handle_grow()) {	// Plus de poignée disponible
+		return NULL;
+	}
+	struct handle *handle = h->free_handle;
+	struct handle **bloc = mem_alloc(size+sizeof(struct handle *));
+	if (bloc == NULL) {
+		return NULL;
+	}
+	*bloc = handle;
+	h->free_handle = handle->next_free;
+	handle->ptr = bloc+1;
+	handle->locks = 0;
+	return &handle->ptr;
+}
+
+void mem_hfree(void **h) {
+	struct handle *handle = (struct handle *)h;
+	if (handle == NULL || handle->ptr == NULL) {
+		return;
+	}
+	mem_free(handle->ptr-sizeof(struct handle *));
+	handle->ptr = NULL;
+	handle->locks = 0;
+	handle->next_free = get_header()->free_handle;	// La poignée redevient libre
+	get_header()->free_handle = handle;
+}
+
+void* mem_hlock(void **h) {
+	struct handle *handle = (struct handle *)h;
+	if (handle == NULL || handle->ptr == NULL) {
+		return NULL;
+	}
+	handle->locks++;
+	return handle->ptr;
+}
+
+void mem_hunlock(void **h) {
+	struct handle *handle = (struct handle *)h;
+	if (handle == NULL || handle->ptr == NULL) {
+		return;
+	}
+	if (handle->locks > 0) {
+		handle->locks--;
+	}
+}
+
+/* Renvoie la poignée de la zone allouée commençant en zone, NULL si la zone
+ * a été allouée par mem_alloc (et n'est donc pas déplaçable)
+ * On vérifie que l'adresse lue en tête de bloc désigne bien une poignée
+ * d'une des tables (en nombre logarithmique) qui pointe sur ce bloc
+ */
+static struct handle *get_handle(void *zone) {
+	struct handle **bloc = zone+sizeof(size_t);
+	struct handle *handle = *bloc;
+	for (struct handle_chunk *c = get_header()->handle_chunks; c != NULL; c = c->next) {
+		if ((void*)handle < (void*)c->handles || (void*)handle >= (void*)(c->handles+c->nb_handles)) {
+			continue;
+		}
+		if (((void*)handle-(void*)c->handles) % sizeof(struct handle) != 0 || handle->ptr != bloc+1) {
+			return NULL;
+		}
+		return handle;
+	}
+	return NULL;
+}
+
+/* Compactage de la mémoire
+ * On parcourt les zones dans l'ordre des adresses en tassant les blocs
+ * relogeables non verrouillés vers le début de la mémoire. Les blocs fixes
+ * (mem_alloc ou verrouillés) restent en place : l'espace libre avant eux
+ * devient une zone libre. On reconstruit la liste des ZL au fur et à mesure.
+ */
+void mem_compact() {
+	void *ptr_end_of_memory = get_system_memory_addr()+get_system_memory_size();
+	void *ptr_current_zone = get_first_zone();
+	void *dest = ptr_current_zone;	// Prochaine position libre après tassement
+	struct fb *old_fb = get_header()->first;	// Ancienne liste des ZL
+	struct fb **lien = &get_header()->first;	// Dernier chaînage de la nouvelle liste
+	struct fb *new_fb;
+	struct fb *last_fb = NULL;	// Dernière ZL de la nouvelle liste
+	get_header()->top = NULL;
+	get_header()->top_prec = NULL;
+	get_header()->holes_max = 0;
+	struct handle *h;
+	size_t block_size;
+
+	while (ptr_current_zone < ptr_end_of_memory) {
+		block_size = *(size_t*)ptr_current_zone;
+
+		if (ptr_current_zone == (void*)old_fb) {	// Zone libre : elle sera absorbée
+			old_fb = old_fb->next;
+
+		} else if ((h = get_handle(ptr_current_zone)) != NULL && h->locks == 0) {	// Zone déplaçable
+			if (dest != ptr_current_zone) {
+				memmove(dest, ptr_current_zone, block_size);	// La taille et la garde sont déplacées avec le bloc
+				VALGRIND_MEMPOOL_CHANGE(get_header(), ptr_current_zone+sizeof(size_t), dest+sizeof(size_t), block_size-sizeof(size_t));
+				h->ptr = dest+sizeof(size_t)+sizeof(struct handle *);
+			}
+			dest += block_size;
+
+		} else {										// Zone fixe
+			if (dest != ptr_current_zone) {	// L'espace tassé avant elle devient une ZL
+				new_fb = dest;
+				new_fb->size = ptr_current_zone-dest;
+				if (new_fb->size > get_header()->holes_max) {
+					get_header()->holes_max = new_fb->size;
+				}
+				*lien = new_fb;
+				lien = &new_fb->next;
+				last_fb = new_fb;
+			}
+			dest = ptr_current_zone+block_size;
+		}
+		ptr_current_zone += block_size;
+	}
+
+	if (dest != ptr_end_of_memory) {	// Tout l'espace restant forme la dernière ZL
+		new_fb = dest;
+		new_fb->size = ptr_end_of_memory-dest;
+		*lien = new_fb;
+		lien = &new_fb->next;
+		get_header()->top = new_fb;
+		get_header()->top_prec = last_fb;
+	}
+	*lien = ptr_end_of_memory;	// Fin de liste
+	if (get_current_fit() == &mem_fit_first_index) {
+		fb_index_rebuild();
+	}
+}
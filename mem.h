@@ -2,6 +2,10 @@
 #define __MEM_H
 #include <stddef.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 struct fb;
 
 /* fonctions principales de l'allocateur */
@@ -25,5 +29,36 @@ void mem_fit(mem_fit_function_t*);
 mem_fit_function_t mem_fit_first;
 mem_fit_function_t mem_fit_worst;
 mem_fit_function_t mem_fit_best;
+mem_fit_function_t mem_fit_first_index;
+
+/* Noyau de recherche de mem_fit_first_index, choisi par mem_init selon le
+ * processeur. Peut être forcé (tests, mesures) : renvoie 0 si le noyau
+ * demandé n'est pas disponible
+ */
+enum mem_index_kernel { MEM_INDEX_AUTO, MEM_INDEX_SCALAR, MEM_INDEX_SSE42, MEM_INDEX_AVX2 };
+int mem_fit_index_kernel(enum mem_index_kernel k);
+
+/* Mode adaptatif : la stratégie est choisie à l'exécution selon la charge
+ * mem_fit_log parcourt le journal des changements de stratégie
+ */
+mem_fit_function_t mem_fit_adaptive;
+void mem_fit_log(void (*print)(size_t alloc, const char *from, const char *to, const char *reason));
+
+/* Allocation relogeable par poignées (handles)
+ * Le bloc est accessible via *h, qui peut changer après mem_compact()
+ * sauf si la poignée est verrouillée (mem_hlock)
+ * Les poignées sont rangées dans des tables allouées dans la mémoire gérée
+ * au premier mem_halloc, puis agrandies au besoin : mem_halloc renvoie NULL
+ * quand la mémoire ne permet plus d'allouer le bloc ou une nouvelle table
+ */
+void** mem_halloc(size_t size);
+void mem_hfree(void **h);
+void* mem_hlock(void **h);
+void mem_hunlock(void **h);
+void mem_compact();
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
@@ -0,0 +1,113 @@
+#ifndef __MEM_ALLOCATOR_HPP
+#define __MEM_ALLOCATOR_HPP
+/* Adaptateurs C++ au-dessus de l'interface de mem.h
+ *
+ * - mem_allocator<T> : allocateur respectant les exigences Allocator de la
+ *   bibliothèque standard, utilisable avec n'importe quel conteneur
+ * - mem_memory_resource : std::pmr::memory_resource pour les conteneurs pmr
+ *
+ * mem_init() doit avoir été appelée avant toute allocation.
+ */
+#include "mem.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <new>
+
+namespace mem_detail {
+
+/* mem_alloc renvoie l'adresse qui suit le size_t de taille du bloc */
+constexpr std::size_t natural_alignment = sizeof(std::size_t);
+
+/* Pour un alignement plus fort, on alloue plus large et on range l'adresse
+ * renvoyée par mem_alloc juste avant la zone alignée
+ */
+inline void *allocate(std::size_t bytes, std::size_t alignment) {
+	if (bytes == 0) {	// mem_alloc refuse les allocations de taille nulle
+		bytes = 1;
+	}
+	if (alignment <= natural_alignment) {
+		void *p = mem_alloc(bytes);
+		if (p == nullptr) {
+			throw std::bad_alloc();
+		}
+		return p;
+	}
+	if (bytes > std::numeric_limits<std::size_t>::max()-alignment-sizeof(void *)) {	// La taille élargie déborderait
+		throw std::bad_alloc();
+	}
+	void *raw = mem_alloc(bytes+alignment+sizeof(void *));
+	if (raw == nullptr) {
+		throw std::bad_alloc();
+	}
+	std::uintptr_t adr = reinterpret_cast<std::uintptr_t>(raw)+sizeof(void *);
+	adr = (adr+alignment-1) & ~(std::uintptr_t)(alignment-1);
+	reinterpret_cast<void **>(adr)[-1] = raw;
+	return reinterpret_cast<void *>(adr);
+}
+
+inline void deallocate(void *p, std::size_t alignment) {
+	if (alignment <= natural_alignment) {
+		mem_free(p);
+	} else {
+		mem_free(static_cast<void **>(p)[-1]);
+	}
+}
+
+}
+
+template <class T>
+struct mem_allocator {
+	using value_type = T;
+
+	mem_allocator() noexcept = default;
+	template <class U>
+	mem_allocator(const mem_allocator<U> &) noexcept {}
+
+	T *allocate(std::size_t n) {
+		if (n > std::numeric_limits<std::size_t>::max()/sizeof(T)) {
+			throw std::bad_array_new_length();
+		}
+		return static_cast<T *>(mem_detail::allocate(n*sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T *p, std::size_t) noexcept {
+		mem_detail::deallocate(p, alignof(T));
+	}
+};
+
+/* Un seul tas global : toutes les instances sont interchangeables */
+template <class T, class U>
+bool operator==(const mem_allocator<T> &, const mem_allocator<U> &) noexcept {
+	return true;
+}
+
+template <class T, class U>
+bool operator!=(const mem_allocator<T> &, const mem_allocator<U> &) noexcept {
+	return false;
+}
+
+class mem_memory_resource : public std::pmr::memory_resource {
+protected:
+	void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+		return mem_detail::allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void *p, std::size_t, std::size_t alignment) override {
+		mem_detail::deallocate(p, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+		return dynamic_cast<const mem_memory_resource *>(&other) != nullptr;
+	}
+};
+
+/* Instance partagée, à passer aux conteneurs std::pmr */
+inline mem_memory_resource *mem_get_memory_resource() {
+	static mem_memory_resource resource;
+	return &resource;
+}
+
+#endif
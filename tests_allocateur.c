@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "mem.h"
 #include "common.h"
 
@@ -56,6 +58,273 @@ void test3() {  // Testing mem_fit_best and mem_fit_worst
     }
 }
 
+void test4() {  // Testing mem_compact with handles
+    mem_init(get_memory_adr(), get_memory_size());
+    size_t taille = get_memory_size()/70;
+    void** tab_handles[64];
+    for (int i=0; i<64; i++){
+        tab_handles[i] = mem_halloc(taille);
+        if (tab_handles[i] == NULL) {
+            printf("Error Test4 : Handle allocation failed\n");
+            return;
+        }
+        *(int *)*tab_handles[i] = i;
+    }
+    for (int i=1; i<64; i+=2){  // Checkerboard fragmentation
+        mem_hfree(tab_handles[i]);
+    }
+    void *gros_bloc = mem_alloc(32*taille);
+    if (gros_bloc != NULL) {
+        printf("Error Test4 : Large allocation should fail before compaction\n");
+    }
+
+    void *verrou = mem_hlock(tab_handles[2]);
+    mem_compact();
+    if (*tab_handles[2] != verrou) {
+        printf("Error Test4 : Locked block was moved by compaction\n");
+    }
+    mem_hunlock(tab_handles[2]);
+    mem_compact();
+
+    for (int i=0; i<64; i+=2){
+        if (*(int *)*tab_handles[i] != i) {
+            printf("Error Test4 : Block content lost by compaction\n");
+        }
+    }
+    gros_bloc = mem_alloc(32*taille);
+    if (gros_bloc == NULL) {
+        printf("Error Test4 : Large allocation failed after compaction\n");
+    }
+
+    mem_init(get_memory_adr(), get_memory_size());
+    for (int i=0; i<200; i++){  // More handles than a fixed 64-entry table
+        if (mem_halloc(16) == NULL) {
+            printf("Error Test4 : Handle table too small\n");
+            break;
+        }
+    }
+    if (mem_hlock(NULL) != NULL) {
+        printf("Error Test4 : Locking a NULL handle\n");
+    }
+    mem_hunlock(NULL);
+}
+
+static size_t oracle_taille;
+static void *oracle_adr;
+
+void test5_oracle(void *adr, size_t size, int free) {  // First free zone large enough
+    if (free && oracle_adr == NULL && size >= oracle_taille) {
+        oracle_adr = adr;
+    }
+}
+
+void test5_kernel(enum mem_index_kernel kernel) {
+    mem_init(get_memory_adr(), get_memory_size());
+    mem_fit(&mem_fit_first_index);
+    mem_fit_index_kernel(kernel);
+    void* tab_free[3000];
+    for (int i=0; i<3000; i++){
+        tab_free[i] = mem_alloc(16+(i*37)%200);
+    }
+    for (int i=0; i<3000; i+=2){  // ~1500 free blocks: the index has to grow
+        mem_free(tab_free[i]);
+    }
+    mem_free(mem_alloc(8));
+    for (int i=0; i<500; i++){
+        size_t taille = 8+(i*53)%300;
+        oracle_taille = (taille+2*sizeof(size_t)+7)/8*8;
+        oracle_adr = NULL;
+        mem_show(test5_oracle);
+        if (mem_alloc(taille) != oracle_adr) {
+            printf("Error Test5 : mem_fit_first_index differs from first fit (kernel %d)\n", kernel);
+            return;
+        }
+        if (i%3 == 0) {
+            mem_free(tab_free[2*i+1]);
+        }
+    }
+}
+
+void test5() {  // Testing mem_fit_first_index with every search kernel available
+    enum mem_index_kernel kernels[3] = {MEM_INDEX_SCALAR, MEM_INDEX_SSE42, MEM_INDEX_AVX2};
+    for (int i=0; i<3; i++){
+        mem_init(get_memory_adr(), get_memory_size());
+        if (mem_fit_index_kernel(kernels[i])) {
+            test5_kernel(kernels[i]);
+        }
+    }
+}
+
+static int nb_decisions;
+static int passe_index;
+static const char *derniere_strategie;
+static size_t premiere_zl;
+
+void test6_log(size_t alloc, const char *from, const char *to, const char *reason) {
+    nb_decisions++;
+    if (strcmp(to, "first_index") == 0) {
+        passe_index = 1;
+    }
+    derniere_strategie = to;
+}
+
+void test6_premiere(void *adr, size_t size, int free) {  // Size of the first free zone
+    if (free && premiere_zl == 0) {
+        premiere_zl = size;
+    }
+}
+
+void test6() {  // Testing mem_fit_adaptive switching to the index on long searches, then back
+    mem_init(get_memory_adr(), get_memory_size());
+    mem_fit(&mem_fit_adaptive);
+    void* tab_free[1000];
+    for (int i=0; i<1000; i++){
+        tab_free[i] = mem_alloc(16+i);
+    }
+    for (int i=0; i<1000; i+=2){  // 500 free blocks of increasing size
+        mem_free(tab_free[i]);
+    }
+    for (int i=0; i<300; i++){  // Only fits in the last free blocks
+        mem_free(mem_alloc(900));
+    }
+    mem_fit_log(test6_log);
+    if (nb_decisions == 0 || !passe_index) {
+        printf("Error Test6 : Adaptive mode did not switch to mem_fit_first_index\n");
+    }
+
+    for (int i=1; i<1000; i+=2){  // Merges the free blocks below the index
+        mem_free(tab_free[i]);
+    }
+    premiere_zl = 0;
+    mem_show(test6_premiere);
+    mem_alloc(premiere_zl-2*sizeof(size_t));  // Fills it: the index is now just before the first free block
+    void *trou = mem_alloc(2000);
+    mem_alloc(16);
+    mem_free(trou);
+    for (int i=0; i<300; i++){  // Few free blocks: back to first fit, which frees the index
+        mem_free(mem_alloc(1000));
+    }
+    derniere_strategie = NULL;
+    mem_fit_log(test6_log);
+    if (derniere_strategie == NULL || strcmp(derniere_strategie, "first") != 0) {
+        printf("Error Test6 : Adaptive mode did not switch back to mem_fit_first\n");
+    }
+}
+
+static int nb_zones_libres;
+
+void test7_compte(void *adr, size_t size, int free) {
+    if (free) {
+        nb_zones_libres++;
+    }
+}
+
+void test7() {  // Testing frees folding back into the wilderness block
+    mem_init(get_memory_adr(), get_memory_size());
+    void* tab_free[100];
+    for (int i=0; i<100; i++){
+        tab_free[i] = mem_alloc(24+i);
+    }
+    for (int i=99; i>=0; i--){  // Each free is adjacent to the top block
+        mem_free(tab_free[i]);
+    }
+    nb_zones_libres = 0;
+    mem_show(test7_compte);
+    if (nb_zones_libres != 1) {
+        printf("Error Test7 : Memory should be a single free block\n");
+    }
+    if (tab_free[0] != mem_alloc(24)) {
+        printf("Error Test7 : Allocation should restart at the beginning of memory\n");
+    }
+}
+
+void test8() {  // Testing mem_realloc growing a block
+    mem_init(get_memory_adr(), get_memory_size());
+    unsigned char *p = mem_alloc(40);
+    void *bouchon = mem_alloc(16);  // Prevents growing in place
+    for (int i=0; i<40; i++){
+        p[i] = i;
+    }
+    unsigned char *q = mem_realloc(p, 4000);
+    if (q == NULL || q == p || mem_get_size(q) < 4000) {
+        printf("Error Test8 : Realloc did not grow the block\n");
+        return;
+    }
+    for (int i=0; i<40; i++){
+        if (q[i] != i) {
+            printf("Error Test8 : Realloc lost the block content\n");
+            return;
+        }
+    }
+    mem_free(q);
+    mem_free(bouchon);
+}
+
+void test9() {  // Testing mem_free on pointers outside the heap
+    mem_init(get_memory_adr(), get_memory_size());
+    void *p = mem_alloc(64);
+    char pile[64];
+    void *libc = malloc(64);
+    mem_free(pile+16);
+    mem_free(libc);
+    free(libc);
+    nb_zones_libres = 0;
+    mem_show(test7_compte);
+    if (nb_zones_libres != 1 || mem_alloc(64) == p) {
+        printf("Error Test9 : Foreign pointers changed the heap\n");
+    }
+}
+
+void test10_fit(mem_fit_function_t *f, const char *nom) {
+    mem_init(get_memory_adr(), get_memory_size());
+    mem_fit(f);
+    void* tab_free[200];
+    for (int i=0; i<200; i++){
+        tab_free[i] = mem_alloc(64);
+    }
+    for (int i=0; i<200; i+=2){  // 100 holes too small for the next request
+        mem_free(tab_free[i]);
+    }
+    void *grand = mem_alloc(1000);
+    if (grand < tab_free[199]) {
+        printf("Error Test10 (%s) : Large request should come from the top block\n", nom);
+    }
+    mem_free(tab_free[1]);  // Merges the first three blocks into a larger hole
+    void *p = mem_alloc(200);
+    if (p == NULL || p > grand) {
+        printf("Error Test10 (%s) : Request fitting a hole should not come from the top block\n", nom);
+    }
+}
+
+void test10() {  // Testing large requests served from the wilderness block
+    test10_fit(&mem_fit_first, "first");
+    test10_fit(&mem_fit_first_index, "first_index");
+    test10_fit(&mem_fit_best, "best");
+}
+
+static int nb_zones_occupees;
+
+void test11_compte(void *adr, size_t size, int free) {
+    if (!free) {
+        nb_zones_occupees++;
+    }
+}
+
+void test11() {  // Testing mem_show up to the end of memory
+    mem_init(get_memory_adr(), get_memory_size());
+    int nb_allocs = 0;
+    for (size_t taille = 64; taille > 0; taille /= 2){  // Fills the memory up to its last bytes
+        while (mem_alloc(taille) != NULL) {
+            nb_allocs++;
+        }
+    }
+    nb_zones_occupees = 0;
+    mem_show(test11_compte);
+    if (nb_zones_occupees != nb_allocs) {
+        printf("Error Test11 : mem_show printed %d blocks out of %d\n", nb_zones_occupees, nb_allocs);
+    }
+}
+
 int main() {
     printf("===============\nTEST 1\n");
     test1();
@@ -66,6 +335,30 @@ int main() {
     printf("===============\nTEST 3\n");
     test3();
     printf("PASSED\n\n");
+    printf("===============\nTEST 4\n");
+    test4();
+    printf("PASSED\n\n");
+    printf("===============\nTEST 5\n");
+    test5();
+    printf("PASSED\n\n");
+    printf("===============\nTEST 6\n");
+    test6();
+    printf("PASSED\n\n");
+    printf("===============\nTEST 7\n");
+    test7();
+    printf("PASSED\n\n");
+    printf("===============\nTEST 8\n");
+    test8();
+    printf("PASSED\n\n");
+    printf("===============\nTEST 9\n");
+    test9();
+    printf("PASSED\n\n");
+    printf("===============\nTEST 10\n");
+    test10();
+    printf("PASSED\n\n");
+    printf("===============\nTEST 11\n");
+    test11();
+    printf("PASSED\n\n");
     printf("All tests successfully passed\n");
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include <cstdio>
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <new>
+#include <vector>
+#include "mem.h"
+#include "common.h"
+#include "mem_allocator.hpp"
+
+struct alignas(64) aligne {
+    char octets[64];
+};
+
+void test1() {  // Testing the alignment of an over-aligned type
+    mem_init(get_memory_adr(), get_memory_size());
+    mem_allocator<aligne> a;
+    for (int i=0; i<10; i++){
+        aligne *p = a.allocate(1+i);
+        if (reinterpret_cast<std::uintptr_t>(p) % alignof(aligne) != 0) {
+            printf("Error Test1 : Block not aligned on %zu bytes\n", alignof(aligne));
+        }
+        a.deallocate(p, 1+i);
+    }
+}
+
+void test2() {  // Testing allocate/deallocate round trips through containers
+    mem_init(get_memory_adr(), get_memory_size());
+    void *avant = mem_alloc(16);
+    mem_free(avant);
+    {
+        std::vector<int, mem_allocator<int>> v;
+        std::list<aligne, mem_allocator<aligne>> l;
+        for (int i=0; i<1000; i++){
+            v.push_back(i);
+            l.emplace_back();
+        }
+        for (int i=0; i<1000; i++){
+            if (v[i] != i) {
+                printf("Error Test2 : Vector content lost\n");
+                return;
+            }
+        }
+        std::pmr::vector<int> pv(mem_get_memory_resource());
+        pv.assign(v.begin(), v.end());
+    }
+    if (mem_alloc(16) != avant) {  // Everything was given back
+        printf("Error Test2 : Memory not released by the containers\n");
+    }
+}
+
+void test3() {  // Testing bad_alloc on oversized requests
+    mem_init(get_memory_adr(), get_memory_size());
+    std::size_t tailles[3] = {get_memory_size(), std::numeric_limits<std::size_t>::max()-7,
+                              std::numeric_limits<std::size_t>::max()};
+    std::size_t alignements[2] = {8, 64};
+    for (int i=0; i<3; i++){
+        for (int j=0; j<2; j++){
+            try {
+                mem_get_memory_resource()->deallocate(
+                    mem_get_memory_resource()->allocate(tailles[i], alignements[j]), tailles[i], alignements[j]);
+                printf("Error Test3 : Allocation of %zu bytes did not throw\n", tailles[i]);
+            } catch (const std::bad_alloc &) {
+            }
+        }
+    }
+}
+
+int main() {
+    printf("===============\nTEST 1\n");
+    test1();
+    printf("PASSED\n\n");
+    printf("===============\nTEST 2\n");
+    test2();
+    printf("PASSED\n\n");
+    printf("===============\nTEST 3\n");
+    test3();
+    printf("PASSED\n\n");
+    printf("All tests successfully passed\n");
+    return 0;
+}